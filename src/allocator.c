@@ -2,25 +2,72 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "allocator.h"
 #define MY_API_SUCCESS 0
 #define MY_API_ERROR_INVALID_ARGUMENT 1
 #define MALLOC_FAIL 2
 #define MAX_HEAP_SIZE 8000
+#define SCRUB_MIN_BLOCK_SIZE 256
 #define COLOR_RESET   "\033[0m"
 #define COLOR_RED     "\033[31m"
 #define COLOR_GREEN   "\033[32m"
 #define COLOR_YELLOW  "\033[33m"
 #define COLOR_BLUE    "\033[34m"
 #define COLOR_GRAY    "\033[90m"
+#define BUCKET_BAR_WIDTH 20
+#define RENDER_LINE_MAX 192
 
 uint8_t *heap = NULL;    
 size_t heap_size = 0;
+small_page_t small_pages[MAX_SMALL_PAGES];
+static bool small_block_mode = false;
 
+static pthread_mutex_t heap_lock;
+static pthread_once_t heap_lock_once = PTHREAD_ONCE_INIT;
 
+static pthread_t maintenance_thread;
+static pthread_mutex_t maintenance_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t maintenance_cond = PTHREAD_COND_INITIALIZER;
+static bool maintenance_running = false;
+// Bumped by every start and stop; a thread exits once it no longer matches.
+static unsigned long maintenance_generation = 0;
+static bool maintenance_requested = false;
+static unsigned int maintenance_interval_ms = 0;
+static size_t maintenance_free_threshold = 0;
+static size_t frees_since_maintenance = 0;
 
-int init_heap(size_t size){
+static bool is_valid_small_page(small_page_t* page);
+static void coalesce_free_blocks(void);
+static void release_block(block_header_t* p_block);
+static void release_empty_small_pages(void);
+
+static void init_heap_lock(void){
+    // Recursive so that entry points can call each other, e.g. realloc
+    // falling back to my_alloc_ff and my_free.
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&heap_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void lock_heap(void){
+    pthread_once(&heap_lock_once, init_heap_lock);
+    pthread_mutex_lock(&heap_lock);
+}
+
+static void unlock_heap(void){
+    pthread_mutex_unlock(&heap_lock);
+}
+
+
+
+static int init_heap_unlocked(size_t size){
     if (size < 1 || size > MAX_HEAP_SIZE){
         printf("Cannot allocate %ld bytes, max is %d\n", size, MAX_HEAP_SIZE);
         return MY_API_ERROR_INVALID_ARGUMENT;
@@ -32,19 +79,29 @@ int init_heap(size_t size){
     if (size % 16 != 0){
         size = size + (16 - (size % 16));
     }
-    heap = malloc(size);
+    heap = calloc(1, size);
     if (!heap){
         printf("Allocation failed, please try again\n");
         return MALLOC_FAIL;
     }
     heap_size = size;
+    frees_since_maintenance = 0;
+    memset(small_pages, 0, sizeof(small_pages));
     block_header_t* header = (block_header_t*)heap; 
     header->block_size = size - sizeof(block_header_t); 
     header->is_free = true;
+    header->is_zeroed = true;
     printf("Heap of %ld bytes successfully allocated\n", size);
     return MY_API_SUCCESS;
 }
 
+int init_heap(size_t size){
+    lock_heap();
+    int result = init_heap_unlocked(size);
+    unlock_heap();
+    return result;
+}
+
 
 
 block_header_t* next_block_header(block_header_t* current_block) {
@@ -83,7 +140,8 @@ bool is_block_free(block_header_t* current_block){
     return current_block->is_free;
 }
 
-block_header_t* header_from_data_ptr(void *data){
+// Callers must already know data is not inside a small page.
+static block_header_t* block_header_at(void *data){
     if (data == NULL){
         return NULL;
     }
@@ -96,7 +154,128 @@ block_header_t* header_from_data_ptr(void *data){
     return (block_header_t*)(byte_ptr);
 }
 
-void *my_alloc_ff(size_t requested_bytes){
+block_header_t* header_from_data_ptr(void *data){
+    // Small blocks have no header; the bytes in front of them belong to a
+    // neighbouring slot or to the page's own block.
+    lock_heap();
+    block_header_t* header = small_page_from_data_ptr(data) ? NULL : block_header_at(data);
+    unlock_heap();
+    return header;
+}
+
+void set_small_block_mode(bool enabled){
+    lock_heap();
+    small_block_mode = enabled;
+    if (!enabled){
+        release_empty_small_pages();
+    }
+    unlock_heap();
+}
+
+small_page_t* small_page_from_data_ptr(void *data){
+    if (data == NULL){
+        return NULL;
+    }
+    uint8_t* byte_data = (uint8_t*)data;
+    for (int i = 0; i < MAX_SMALL_PAGES; i++){
+        small_page_t* page = &small_pages[i];
+        if (page->start != NULL && byte_data >= page->start && byte_data < page->start + SMALL_PAGE_SIZE){
+            return page;
+        }
+    }
+    return NULL;
+}
+
+static small_page_t* add_small_page(size_t slot_size){
+    for (int i = 0; i < MAX_SMALL_PAGES; i++){
+        small_page_t* page = &small_pages[i];
+        if (page->start != NULL){
+            continue;
+        }
+        uint8_t* start = (uint8_t*)my_alloc_ff(SMALL_PAGE_SIZE);
+        if (!start){
+            return NULL;
+        }
+        page->start = start;
+        page->slot_size = slot_size;
+        page->slot_count = SMALL_PAGE_SIZE / slot_size;
+        page->used_count = 0;
+        page->used_mask = 0;
+        return page;
+    }
+    return NULL;
+}
+
+static small_page_t* small_page_with_free_slot(size_t slot_size){
+    for (int i = 0; i < MAX_SMALL_PAGES; i++){
+        small_page_t* page = &small_pages[i];
+        if (page->start != NULL && page->slot_size == slot_size && page->used_count < page->slot_count){
+            return page;
+        }
+    }
+    return NULL;
+}
+
+static void *small_alloc(size_t requested_bytes){
+    small_page_t* page = small_page_with_free_slot(requested_bytes);
+    if (!page){
+        page = add_small_page(requested_bytes);
+    }
+    if (!page){
+        return NULL;
+    }
+    for (uint16_t slot = 0; slot < page->slot_count; slot++){
+        if (!(page->used_mask & ((uint64_t)1 << slot))){
+            page->used_mask |= (uint64_t)1 << slot;
+            page->used_count++;
+            return page->start + (size_t)slot * page->slot_size;
+        }
+    }
+    return NULL;
+}
+
+static bool small_slot_bit(small_page_t* page, void* p, uint64_t* bit){
+    size_t offset = (uint8_t*)p - page->start;
+    if (offset % page->slot_size != 0 || offset / page->slot_size >= page->slot_count){
+        return false;
+    }
+    *bit = (uint64_t)1 << (offset / page->slot_size);
+    return true;
+}
+
+static void small_free(small_page_t* page, void* p){
+    uint64_t bit;
+    if (!small_slot_bit(page, p, &bit)){
+        printf("no header\n");
+        return;
+    }
+    if (!(page->used_mask & bit)){
+        printf("already freed\n");
+        return;
+    }
+    page->used_mask &= ~bit;
+    page->used_count--;
+    if (page->used_count == 0){
+        uint8_t* start = page->start;
+        memset(page, 0, sizeof(*page));
+        my_free(start);
+    }
+}
+
+// Pages pre-split by maintenance can stay empty forever, since small_free
+// only releases a page when its last slot is freed.
+static void release_empty_small_pages(void){
+    for (int i = 0; i < MAX_SMALL_PAGES; i++){
+        small_page_t* page = &small_pages[i];
+        if (page->start != NULL && page->used_count == 0){
+            uint8_t* start = page->start;
+            memset(page, 0, sizeof(*page));
+            my_free(start);
+        }
+    }
+}
+
+static void *alloc_ff_unlocked(size_t requested_bytes){
     if (!heap){
         return NULL;
     }
@@ -109,6 +288,13 @@ void *my_alloc_ff(size_t requested_bytes){
     if (requested_bytes % 16 != 0){
         requested_bytes = requested_bytes + (16 - (requested_bytes % 16));
     }
+    if (small_block_mode && requested_bytes <= SMALL_BLOCK_THRESHOLD){
+        // No room for another page falls back to a normal block.
+        void *p_small = small_alloc(requested_bytes);
+        if (p_small){
+            return p_small;
+        }
+    }
     block_header_t *current = (block_header_t*)(heap); 
     while (current != NULL){
         if (current->is_free && current->block_size >= requested_bytes){
@@ -118,20 +304,33 @@ void *my_alloc_ff(size_t requested_bytes){
             current->block_size = requested_bytes;
             current->is_free = false;
             
-            size_t left_over_space = original_size - requested_bytes - sizeof(block_header_t);
-            if (left_over_space < sizeof(block_header_t)){
+            if (original_size - requested_bytes < 2 * sizeof(block_header_t)){
+                current->block_size = original_size;
                 return p_my_alloc;
             }
+            size_t left_over_space = original_size - requested_bytes - sizeof(block_header_t);
             block_header_t* new_block = (block_header_t*)((uint8_t*)(current) + sizeof(block_header_t) + requested_bytes);
             new_block->block_size = left_over_space;
             new_block->is_free = true;
+            new_block->is_zeroed = current->is_zeroed;
             return p_my_alloc;
         }
         current = next_block_header(current);
     }return NULL;
 }
 
-void *my_alloc_bf(size_t requested_bytes){
+void *my_alloc_ff(size_t requested_bytes){
+    lock_heap();
+    void *p = alloc_ff_unlocked(requested_bytes);
+    if (!p && maintenance_running){
+        coalesce_free_blocks();
+        p = alloc_ff_unlocked(requested_bytes);
+    }
+    unlock_heap();
+    return p;
+}
+
+static void *alloc_bf_unlocked(size_t requested_bytes){
     if (!heap){
         return NULL;
     }
@@ -144,6 +343,13 @@ void *my_alloc_bf(size_t requested_bytes){
     if (requested_bytes % 16 != 0){
     requested_bytes = requested_bytes + (16 - (requested_bytes % 16));
     }
+    if (small_block_mode && requested_bytes <= SMALL_BLOCK_THRESHOLD){
+        // No room for another page falls back to a normal block.
+        void *p_small = small_alloc(requested_bytes);
+        if (p_small){
+            return p_small;
+        }
+    }
     block_header_t* current = (block_header_t*)(heap); 
     block_header_t* smallest_block = NULL;
 
@@ -164,22 +370,106 @@ void *my_alloc_bf(size_t requested_bytes){
     smallest_block->block_size = requested_bytes;
     smallest_block->is_free = false;
     
-    size_t left_over_space = original_size - requested_bytes - sizeof(block_header_t);
-    if (left_over_space < sizeof(block_header_t)){
+    if (original_size - requested_bytes < 2 * sizeof(block_header_t)){
+        smallest_block->block_size = original_size;
         return p_my_alloc;
     }
+    size_t left_over_space = original_size - requested_bytes - sizeof(block_header_t);
     block_header_t* new_block = (block_header_t*)((uint8_t*)(smallest_block) + sizeof(block_header_t) + requested_bytes);
     new_block->block_size = left_over_space;
     new_block->is_free = true;
+    new_block->is_zeroed = smallest_block->is_zeroed;
     return p_my_alloc;
 }
 
-void my_free(void* p){
+void *my_alloc_bf(size_t requested_bytes){
+    lock_heap();
+    void *p = alloc_bf_unlocked(requested_bytes);
+    if (!p && maintenance_running){
+        coalesce_free_blocks();
+        p = alloc_bf_unlocked(requested_bytes);
+    }
+    unlock_heap();
+    return p;
+}
+
+static void *alloc_exclusive_unlocked(size_t requested_bytes){
+    if (!heap){
+        return NULL;
+    }
+    if (requested_bytes > heap_size){
+        return NULL;
+    }
+    if (requested_bytes <= 0){
+        return NULL;
+    }
+    if (requested_bytes % CACHE_LINE_SIZE != 0){
+        requested_bytes = requested_bytes + (CACHE_LINE_SIZE - (requested_bytes % CACHE_LINE_SIZE));
+    }
+    block_header_t *current = (block_header_t*)(heap);
+    while (current != NULL){
+        if (current->is_free){
+            uint8_t* block_start = (uint8_t*)current;
+            uint8_t* block_end = block_start + sizeof(block_header_t) + current->block_size;
+            uintptr_t first_payload = (uintptr_t)(block_start + sizeof(block_header_t));
+            uintptr_t aligned_payload = (first_payload + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+            size_t front_gap = aligned_payload - first_payload;
+            // The gap in front of the payload has to hold a free block of its
+            // own (header plus a minimum payload), otherwise move a line further.
+            if (front_gap != 0 && front_gap < 2 * sizeof(block_header_t)){
+                aligned_payload += CACHE_LINE_SIZE;
+                front_gap += CACHE_LINE_SIZE;
+            }
+            uint8_t* p_my_alloc = (uint8_t*)aligned_payload;
+            if (p_my_alloc + requested_bytes <= block_end){
+                bool was_zeroed = current->is_zeroed;
+                block_header_t* target = current;
+                if (front_gap != 0){
+                    current->block_size = front_gap - sizeof(block_header_t);
+                    target = (block_header_t*)(p_my_alloc - sizeof(block_header_t));
+                    target->block_size = block_end - p_my_alloc;
+                }
+                target->is_free = false;
+                target->is_zeroed = was_zeroed;
+
+                size_t available_space = target->block_size;
+                if (available_space - requested_bytes < 2 * sizeof(block_header_t)){
+                    return p_my_alloc;
+                }
+                target->block_size = requested_bytes;
+                block_header_t* new_block = (block_header_t*)(p_my_alloc + requested_bytes);
+                new_block->block_size = available_space - requested_bytes - sizeof(block_header_t);
+                new_block->is_free = true;
+                new_block->is_zeroed = was_zeroed;
+                return p_my_alloc;
+            }
+        }
+        current = next_block_header(current);
+    }return NULL;
+}
+
+void *my_alloc_exclusive(size_t requested_bytes){
+    lock_heap();
+    void *p = alloc_exclusive_unlocked(requested_bytes);
+    if (!p && maintenance_running){
+        coalesce_free_blocks();
+        p = alloc_exclusive_unlocked(requested_bytes);
+    }
+    unlock_heap();
+    return p;
+}
+
+static void free_unlocked(void* p){
     if (p == NULL){
         printf("pointer is null\n");
         return;
     }
-    block_header_t* p_block = header_from_data_ptr(p);
+    small_page_t* page = small_page_from_data_ptr(p);
+    if (page){
+        small_free(page, p);
+        return;
+    }
+    block_header_t* p_block = block_header_at(p);
     if (!p_block){
         printf("no header\n");
         return;
@@ -188,116 +478,626 @@ void my_free(void* p){
         printf("already freed\n");
         return;
     }
+    release_block(p_block);
+}
+
+static void release_block(block_header_t* p_block){
     p_block->is_free = true;
+    // The caller may have written anything into the payload, so the merged
+    // block can no longer be assumed to be zero.
+    p_block->is_zeroed = false;
     
     block_header_t* next_block = next_block_header(p_block);
     if (next_block && next_block->is_free){
         p_block->block_size = p_block->block_size + sizeof(block_header_t) + next_block->block_size;
     }
     
+    if (maintenance_running){
+        // Finding the previous block is a walk from the start of the heap,
+        // so leave that merge to the maintenance thread. Every such free may
+        // leave two free blocks side by side, so the count of them is the
+        // fragmentation trigger.
+        frees_since_maintenance++;
+        if (maintenance_free_threshold != 0 && frees_since_maintenance >= maintenance_free_threshold){
+            frees_since_maintenance = 0;
+            trigger_heap_maintenance();
+        }
+        return;
+    }
     block_header_t* previous_block = previous_block_header(p_block);
     if (previous_block && previous_block->is_free){
         previous_block->block_size = previous_block->block_size + sizeof(block_header_t) + p_block->block_size;
+        previous_block->is_zeroed = false;
     }
 }
 
+void my_free(void* p){
+    lock_heap();
+    free_unlocked(p);
+    unlock_heap();
+}
+
+static void free_sized_unlocked(void* p, size_t size){
+    if (p == NULL){
+        return;
+    }
+    if (size % ALIGNMENT != 0){
+        size = size + (ALIGNMENT - (size % ALIGNMENT));
+    }
+    // Only requests that could have been small blocks need the page lookup.
+    if (size <= SMALL_BLOCK_THRESHOLD){
+        small_page_t* page = small_page_from_data_ptr(p);
+        if (page){
+#ifndef NDEBUG
+            // Only an upper bound: realloc keeps a small block in its slot
+            // when it shrinks, so a smaller size is legitimate here.
+            if (size > page->slot_size){
+                printf("size %zu does not match small block of %u\n", size, page->slot_size);
+                return;
+            }
+#endif
+            small_free(page, p);
+            return;
+        }
+    }
+    block_header_t* p_block = (block_header_t*)((uint8_t*)p - sizeof(block_header_t));
+#ifndef NDEBUG
+    if (header_from_data_ptr(p) != p_block){
+        printf("no header\n");
+        return;
+    }
+    if (p_block->is_free){
+        printf("already freed\n");
+        return;
+    }
+    // A block can be larger than the rounded request by a leftover that was
+    // too small to split off, and my_alloc_exclusive also rounds up to
+    // whole cache lines.
+    size_t max_slack = sizeof(block_header_t);
+    if ((uintptr_t)p % CACHE_LINE_SIZE == 0){
+        max_slack += CACHE_LINE_SIZE - ALIGNMENT;
+    }
+    if (size > p_block->block_size || size + max_slack < p_block->block_size){
+        printf("size %zu does not match block of %zu\n", size, p_block->block_size);
+        return;
+    }
+#endif
+    release_block(p_block);
+}
+
+void my_free_sized(void* p, size_t size){
+    lock_heap();
+    free_sized_unlocked(p, size);
+    unlock_heap();
+}
+
+size_t my_usable_size(void* p){
+    if (p == NULL){
+        return 0;
+    }
+    lock_heap();
+    size_t usable = 0;
+    small_page_t* page = small_page_from_data_ptr(p);
+    uint64_t bit;
+    if (page){
+        if (small_slot_bit(page, p, &bit) && (page->used_mask & bit)){
+            usable = page->slot_size;
+        }
+    }else if ((uintptr_t)p % ALIGNMENT == 0){
+        block_header_t* header = block_header_at(p);
+        if (header && !header->is_free){
+            usable = header->block_size;
+        }
+    }
+    unlock_heap();
+    return usable;
+}
+
+static void *calloc_unlocked(size_t count, size_t size){
+    if (count == 0 || size == 0){
+        return NULL;
+    }
+    if (count > SIZE_MAX / size){
+        return NULL;
+    }
+    size_t total_bytes = count * size;
+    void *p = my_alloc_ff(total_bytes);
+    if (!p){
+        return NULL;
+    }
+    small_page_t* page = small_page_from_data_ptr(p);
+    if (page){
+        memset(p, 0, page->slot_size);
+        return p;
+    }
+    block_header_t* header = block_header_at(p);
+    if (!header->is_zeroed){
+        memset(p, 0, header->block_size);
+    }
+    header->is_zeroed = false;
+    return p;
+}
+
+void *my_calloc(size_t count, size_t size){
+    lock_heap();
+    void *p = calloc_unlocked(count, size);
+    unlock_heap();
+    return p;
+}
+
+size_t heap_walk(heap_walk_callback_t callback, void *ctx, unsigned int flags, size_t min_size, size_t max_size){
+    if (!callback){
+        return 0;
+    }
+    lock_heap();
+    size_t visited = 0;
+    block_header_t *current = heap ? (block_header_t*)heap : NULL;
+    while (current != NULL) {
+        bool wanted = current->is_free ? (flags & HEAP_WALK_FREE) : (flags & HEAP_WALK_USED);
+        if (wanted && (flags & HEAP_WALK_SIZE_RANGE)){
+            wanted = current->block_size >= min_size && current->block_size <= max_size;
+        }
+        if (wanted){
+            heap_block_info_t info = {
+                .header = current,
+                .payload = (uint8_t*)current + sizeof(block_header_t),
+                .offset = (uint8_t*)current - heap,
+                .size = current->block_size,
+                .is_free = current->is_free,
+            };
+            visited++;
+            if (!callback(&info, ctx)){
+                break;
+            }
+        }
+        current = next_block_header(current);
+    }
+    unlock_heap();
+    return visited;
+}
+
+typedef struct SnapshotWalk{
+    FILE *f;
+    bool first;
+} snapshot_walk_t;
+
+static bool snapshot_block(const heap_block_info_t *block, void *ctx){
+    snapshot_walk_t *walk = (snapshot_walk_t*)ctx;
+    if (!walk->first) {
+        fprintf(walk->f, ",\n");
+    }
+    walk->first = false;
+    fprintf(walk->f, "    {\"offset\": %zu, \"size\": %zu, \"is_free\": %s, \"block_header_size\": %ld}", 
+            block->offset, block->size, block->is_free ? "true" : "false", sizeof(block_header_t));
+    return true;
+}
+
+static void snapshot_begin(snapshot_walk_t *walk){
+    fprintf(walk->f, "{\n");
+    fprintf(walk->f, "  \"heap_size\": %zu,\n", heap_size);
+    fprintf(walk->f, "  \"blocks\": [\n");
+}
+
+static void snapshot_end(snapshot_walk_t *walk){
+    if (!walk->first) {
+        fprintf(walk->f, "\n");
+    }
+    fprintf(walk->f, "  ]\n");
+    fprintf(walk->f, "}\n");
+}
+
 void export_heap_snapshot(const char *filename) {
     FILE *f = fopen(filename, "w");
     if (!f) {
         printf("Failed to open file\n");
         return;
     }
-    
-    fprintf(f, "{\n");
-    fprintf(f, "  \"heap_size\": %zu,\n", heap_size);
-    fprintf(f, "  \"blocks\": [\n");
-    
-    block_header_t *current = (block_header_t*)heap;
-    while (current != NULL) {
-        size_t offset = (uint8_t*)current - heap;
-        
-        fprintf(f, "    {\"offset\": %zu, \"size\": %zu, \"is_free\": %s, \"block_header_size\": %ld}", 
-                offset, current->block_size, current->is_free ? "true" : "false", sizeof(block_header_t));
-        
-        if (next_block_header(current) != NULL) {
-            fprintf(f, ",");
-        }
-        fprintf(f, "\n");
-        current = next_block_header(current);
-    }
-    
-    fprintf(f, "  ]\n");
-    fprintf(f, "}\n");
+    snapshot_walk_t walk = { f, true };
+    snapshot_begin(&walk);
+    heap_walk(snapshot_block, &walk, HEAP_WALK_ALL, 0, 0);
+    snapshot_end(&walk);
     fclose(f);
 }
 
+static int bar_length_for(size_t block_size){
+    int bar_length = (block_size * 100) / heap_size;
+    if (bar_length < 1) bar_length = 1;
+    return bar_length;
+}
+
+static bool visualize_block(const heap_block_info_t *block, void *ctx){
+    (void)ctx;
+    const char *color = block->is_free ? COLOR_GREEN : COLOR_RED;
+    const char *status = block->is_free ? "FREE" : "USED";
+
+    printf("%s[%s]%s offset=%zu size=%zu\n", 
+           color, status, COLOR_RESET,
+           block->offset,
+           block->size);
+
+    printf("  %s", color);
+    int bar_length = bar_length_for(block->size);
+    for (int i = 0; i < bar_length; i++) {
+        printf(block->is_free ? "░" : "█");
+    }
+    printf("%s\n\n", COLOR_RESET);
+    return true;
+}
+
+// The overview is built up in memory so it can be printed after the
+// per-block lines when both come from the same walk.
+typedef struct OverviewWalk{
+    char *text;
+    size_t length;
+    size_t capacity;
+} overview_walk_t;
+
+static void overview_append(overview_walk_t *walk, const char *piece){
+    size_t piece_length = strlen(piece);
+    if (walk->length + piece_length + 1 > walk->capacity){
+        size_t new_capacity = walk->capacity ? walk->capacity * 2 : 256;
+        while (new_capacity < walk->length + piece_length + 1){
+            new_capacity *= 2;
+        }
+        char *grown = realloc(walk->text, new_capacity);
+        if (!grown){
+            return;
+        }
+        walk->text = grown;
+        walk->capacity = new_capacity;
+    }
+    memcpy(walk->text + walk->length, piece, piece_length + 1);
+    walk->length += piece_length;
+}
+
+static bool overview_block(const heap_block_info_t *block, void *ctx){
+    overview_walk_t *walk = (overview_walk_t*)ctx;
+    overview_append(walk, block->is_free ? COLOR_GREEN : COLOR_RED);
+    int bar_length = bar_length_for(block->size);
+    for (int i = 0; i < bar_length; i++) {
+        overview_append(walk, block->is_free ? "░" : "█");
+    }
+    overview_append(walk, COLOR_RESET);
+    return true;
+}
+
+static void overview_print(overview_walk_t *walk){
+    printf("\nOverview:\n[%s]\n", walk->text ? walk->text : "");
+    free(walk->text);
+}
+
 void visualize_heap() {
     printf("\n" COLOR_BLUE "=== HEAP VISUALIZATION ===" COLOR_RESET "\n");
-    
-    block_header_t *current = (block_header_t*)heap;
-    
-    while (current != NULL) {
-        const char *color = current->is_free ? COLOR_GREEN : COLOR_RED;
-        const char *status = current->is_free ? "FREE" : "USED";
-        
-        printf("%s[%s]%s offset=%zu size=%zu\n", 
-               color, status, COLOR_RESET,
-               (uint8_t*)current - heap,
-               current->block_size);
-        
-        printf("  %s", color);
-        int bar_length = (current->block_size * 100) / heap_size; 
-        if (bar_length < 1) bar_length = 1;  
-        for (int i = 0; i < bar_length; i++) {
-            printf(current->is_free ? "░" : "█");
-        }
-        printf("%s\n\n", COLOR_RESET);
-        
-        current = next_block_header(current);
-    }
+    heap_walk(visualize_block, NULL, HEAP_WALK_ALL, 0, 0);
     print_heap_overview();
     printf("==========================\n");
 }
 
 void print_heap_overview() {
-    printf("\nOverview:\n[");
-    
-    block_header_t *current = (block_header_t*)heap;
-    
-    while (current != NULL) {
-        const char *color = current->is_free ? COLOR_GREEN : COLOR_RED;
-        int bar_length = (current->block_size * 100) / heap_size;
-        if (bar_length < 1) bar_length = 1;
-        
-        printf("%s", color);
-        for (int i = 0; i < bar_length; i++) {
-            printf(current->is_free ? "░" : "█");
-        }
-        printf(COLOR_RESET);
-        
-        current = next_block_header(current);
+    overview_walk_t walk = { NULL, 0, 0 };
+    heap_walk(overview_block, &walk, HEAP_WALK_ALL, 0, 0);
+    overview_print(&walk);
+}
+
+typedef struct IntegrityWalk{
+    size_t total_accounted;
+    bool ok;
+} integrity_walk_t;
+
+static bool integrity_block(const heap_block_info_t *block, void *ctx){
+    integrity_walk_t *walk = (integrity_walk_t*)ctx;
+    if (!is_valid_header(block->header)){
+        walk->ok = false;
+        return false;
     }
-    
-    printf("]\n");
+    walk->total_accounted += sizeof(block_header_t) + block->size;
+    return true;
 }
 
-bool check_heap_integrity(){
+static bool integrity_finish(integrity_walk_t *walk){
+    if (!walk->ok){
+        return false;
+    }
+    if (walk->total_accounted != heap_size){
+        printf("ERROR: Total accounted (%zu) doesn't match heap_size (%zu)\n", 
+                walk->total_accounted, heap_size);
+        return false;
+    }
+    for (int i = 0; i < MAX_SMALL_PAGES; i++){
+        if (small_pages[i].start != NULL && !is_valid_small_page(&small_pages[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_heap_integrity_unlocked(){
     if (!heap){
         printf("ERROR: Heap not initialized\n");
         return false;
     }
-    block_header_t *current = (block_header_t*)heap;
-    size_t total_accounted = 0;
-    while (current != NULL) {
-        if (!is_valid_header(current)){
-            return false;
+    integrity_walk_t walk = { 0, true };
+    heap_walk(integrity_block, &walk, HEAP_WALK_ALL, 0, 0);
+    return integrity_finish(&walk);
+}
+
+typedef struct DiagnosticsWalk{
+    snapshot_walk_t snapshot;
+    overview_walk_t overview;
+    integrity_walk_t integrity;
+} diagnostics_walk_t;
+
+static bool diagnostics_block(const heap_block_info_t *block, void *ctx){
+    diagnostics_walk_t *walk = (diagnostics_walk_t*)ctx;
+    // A bad header means the rest of the layout can't be trusted either.
+    if (!integrity_block(block, &walk->integrity)){
+        return false;
+    }
+    visualize_block(block, NULL);
+    overview_block(block, &walk->overview);
+    if (walk->snapshot.f){
+        snapshot_block(block, &walk->snapshot);
+    }
+    return true;
+}
+
+bool collect_heap_diagnostics(const char *snapshot_filename){
+    diagnostics_walk_t walk = { { NULL, true }, { NULL, 0, 0 }, { 0, true } };
+    if (snapshot_filename){
+        walk.snapshot.f = fopen(snapshot_filename, "w");
+        if (!walk.snapshot.f) {
+            printf("Failed to open file\n");
         }
-        total_accounted += sizeof(block_header_t) + current->block_size;
-        current = next_block_header(current);
     }
-    if (total_accounted != heap_size){
-        printf("ERROR: Total accounted (%zu) doesn't match heap_size (%zu)\n", 
-                total_accounted, heap_size);
+    lock_heap();
+    if (!heap){
+        unlock_heap();
+        if (walk.snapshot.f){
+            fclose(walk.snapshot.f);
+        }
+        printf("ERROR: Heap not initialized\n");
+        return false;
+    }
+    if (walk.snapshot.f){
+        snapshot_begin(&walk.snapshot);
+    }
+    printf("\n" COLOR_BLUE "=== HEAP VISUALIZATION ===" COLOR_RESET "\n");
+    heap_walk(diagnostics_block, &walk, HEAP_WALK_ALL, 0, 0);
+    overview_print(&walk.overview);
+    printf("==========================\n");
+    if (walk.snapshot.f){
+        snapshot_end(&walk.snapshot);
+        fclose(walk.snapshot.f);
+    }
+    bool ok = integrity_finish(&walk.integrity);
+    unlock_heap();
+    return ok;
+}
+
+typedef struct BucketWalk{
+    bucket_stats_t *stats;
+    int bucket_count;
+    size_t bucket_bytes;
+} bucket_walk_t;
+
+static void add_span_to_buckets(bucket_walk_t *walk, size_t start, size_t end, bool is_free){
+    for (size_t bucket = start / walk->bucket_bytes; bucket < (size_t)walk->bucket_count; bucket++){
+        size_t bucket_start = bucket * walk->bucket_bytes;
+        if (bucket_start >= end){
+            break;
+        }
+        size_t bucket_end = bucket_start + walk->bucket_bytes;
+        size_t overlap_start = start > bucket_start ? start : bucket_start;
+        size_t overlap_end = end < bucket_end ? end : bucket_end;
+        size_t overlap = overlap_end - overlap_start;
+        if (is_free){
+            if (overlap > walk->stats[bucket].largest_free_run){
+                walk->stats[bucket].largest_free_run = overlap;
+            }
+        }else{
+            walk->stats[bucket].used_bytes += overlap;
+        }
+    }
+}
+
+static bool bucket_block(const heap_block_info_t *block, void *ctx){
+    bucket_walk_t *walk = (bucket_walk_t*)ctx;
+    size_t payload_start = block->offset + sizeof(block_header_t);
+    add_span_to_buckets(walk, block->offset, payload_start, false);
+    add_span_to_buckets(walk, payload_start, payload_start + block->size, block->is_free);
+    return true;
+}
+
+size_t heap_bucket_stats(bucket_stats_t *stats, int bucket_count){
+    if (!stats || bucket_count < 1 || bucket_count > MAX_RENDER_BUCKETS){
+        return 0;
+    }
+    memset(stats, 0, sizeof(bucket_stats_t) * bucket_count);
+    lock_heap();
+    if (!heap){
+        unlock_heap();
+        return 0;
+    }
+    bucket_walk_t walk = { stats, bucket_count, (heap_size + bucket_count - 1) / bucket_count };
+    for (int i = 0; i < bucket_count; i++){
+        size_t bucket_start = (size_t)i * walk.bucket_bytes;
+        size_t bucket_end = bucket_start + walk.bucket_bytes;
+        if (bucket_start > heap_size){
+            bucket_start = heap_size;
+        }
+        if (bucket_end > heap_size){
+            bucket_end = heap_size;
+        }
+        stats[i].bucket_bytes = bucket_end - bucket_start;
+    }
+    heap_walk(bucket_block, &walk, HEAP_WALK_ALL, 0, 0);
+    unlock_heap();
+    return walk.bucket_bytes;
+}
+
+// Big enough for a title line plus one line per bucket, so a whole frame is
+// built here and handed to the terminal with a single write(). render_lock
+// guards the buffer and the refresh state, not the heap, so a slow
+// terminal never holds up allocations.
+static char render_buffer[256 + MAX_RENDER_BUCKETS * RENDER_LINE_MAX];
+static size_t render_length = 0;
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void render_append(const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(render_buffer + render_length, sizeof(render_buffer) - render_length, format, args);
+    va_end(args);
+    if (written > 0){
+        render_length += (size_t)written;
+        if (render_length >= sizeof(render_buffer)){
+            render_length = sizeof(render_buffer) - 1;
+        }
+    }
+}
+
+static void render_flush(int fd){
+    size_t offset = 0;
+    while (offset < render_length){
+        ssize_t written = write(fd, render_buffer + offset, render_length - offset);
+        if (written <= 0){
+            break;
+        }
+        offset += (size_t)written;
+    }
+    render_length = 0;
+}
+
+static void render_bucket_line(int index, size_t bucket_bytes, const bucket_stats_t *bucket){
+    int used_percent = bucket->bucket_bytes ? (int)((bucket->used_bytes * 100) / bucket->bucket_bytes) : 0;
+    int used_cells = bucket->bucket_bytes ? (int)((bucket->used_bytes * BUCKET_BAR_WIDTH) / bucket->bucket_bytes) : 0;
+    if (bucket->used_bytes > 0 && used_cells == 0) used_cells = 1;
+
+    render_append("%4d %6zu [" COLOR_RED, index, (size_t)index * bucket_bytes);
+    for (int i = 0; i < used_cells; i++){
+        render_append("█");
+    }
+    render_append(COLOR_GREEN);
+    for (int i = used_cells; i < BUCKET_BAR_WIDTH; i++){
+        render_append("░");
+    }
+    render_append(COLOR_RESET "] %3d%% used, largest free %zu", used_percent, bucket->largest_free_run);
+}
+
+static size_t stats_heap_size(const bucket_stats_t *stats, int bucket_count){
+    size_t total = 0;
+    for (int i = 0; i < bucket_count; i++){
+        total += stats[i].bucket_bytes;
+    }
+    return total;
+}
+
+static void render_bucket_title(int bucket_count, size_t bucket_bytes, size_t total_bytes){
+    render_append(COLOR_BLUE "=== HEAP BUCKETS: %d x %zu bytes (heap %zu) ===" COLOR_RESET,
+                  bucket_count, bucket_bytes, total_bytes);
+}
+
+void visualize_heap_buckets_to_fd(int fd, int bucket_count){
+    bucket_stats_t stats[MAX_RENDER_BUCKETS];
+    size_t bucket_bytes = heap_bucket_stats(stats, bucket_count);
+    if (bucket_bytes == 0){
+        printf("Cannot render %d buckets, heap must be initialized and 1 to %d buckets\n",
+               bucket_count, MAX_RENDER_BUCKETS);
+        return;
+    }
+    pthread_mutex_lock(&render_lock);
+    render_append("\n");
+    render_bucket_title(bucket_count, bucket_bytes, stats_heap_size(stats, bucket_count));
+    render_append("\n");
+    for (int i = 0; i < bucket_count; i++){
+        render_bucket_line(i, bucket_bytes, &stats[i]);
+        render_append("\n");
+    }
+    render_flush(fd);
+    pthread_mutex_unlock(&render_lock);
+}
+
+void visualize_heap_buckets(int bucket_count){
+    fflush(stdout);
+    visualize_heap_buckets_to_fd(STDOUT_FILENO, bucket_count);
+}
+
+static bucket_stats_t shown_stats[MAX_RENDER_BUCKETS];
+static int shown_bucket_count = 0;
+static size_t shown_heap_size = 0;
+
+void refresh_heap_buckets_to_fd(int fd, int bucket_count){
+    bucket_stats_t stats[MAX_RENDER_BUCKETS];
+    size_t bucket_bytes = heap_bucket_stats(stats, bucket_count);
+    if (bucket_bytes == 0){
+        printf("Cannot render %d buckets, heap must be initialized and 1 to %d buckets\n",
+               bucket_count, MAX_RENDER_BUCKETS);
+        return;
+    }
+    size_t total_bytes = stats_heap_size(stats, bucket_count);
+    pthread_mutex_lock(&render_lock);
+    bool full_redraw = shown_bucket_count != bucket_count || shown_heap_size != total_bytes;
+    if (full_redraw){
+        render_append("\033[2J\033[1;1H");
+        render_bucket_title(bucket_count, bucket_bytes, total_bytes);
+    }
+    // Row 1 is the title, bucket i is drawn on row i + 2.
+    for (int i = 0; i < bucket_count; i++){
+        if (!full_redraw && memcmp(&stats[i], &shown_stats[i], sizeof(bucket_stats_t)) == 0){
+            continue;
+        }
+        render_append("\033[%d;1H", i + 2);
+        render_bucket_line(i, bucket_bytes, &stats[i]);
+        render_append("\033[K");
+    }
+    render_append("\033[%d;1H", bucket_count + 2);
+    render_flush(fd);
+
+    memcpy(shown_stats, stats, sizeof(bucket_stats_t) * bucket_count);
+    shown_bucket_count = bucket_count;
+    shown_heap_size = total_bytes;
+    pthread_mutex_unlock(&render_lock);
+}
+
+void refresh_heap_buckets(int bucket_count){
+    fflush(stdout);
+    refresh_heap_buckets_to_fd(STDOUT_FILENO, bucket_count);
+}
+
+bool check_heap_integrity(){
+    lock_heap();
+    bool ok = check_heap_integrity_unlocked();
+    unlock_heap();
+    return ok;
+}
+
+static bool is_valid_small_page(small_page_t* page){
+    block_header_t* header = block_header_at(page->start);
+    if (!header || header->is_free || header->block_size < SMALL_PAGE_SIZE){
+        printf("ERROR: Small page at %p is not backed by a used heap block\n", page->start);
+        return false;
+    }
+    if (page->slot_size == 0 || page->slot_size % ALIGNMENT != 0 || page->slot_size > SMALL_BLOCK_THRESHOLD){
+        printf("ERROR: Small page at %p has bad size class %u\n", page->start, page->slot_size);
+        return false;
+    }
+    if (page->slot_count != SMALL_PAGE_SIZE / page->slot_size){
+        printf("ERROR: Small page at %p has bad slot count\n", page->start);
+        return false;
+    }
+    uint16_t used = 0;
+    for (uint16_t slot = 0; slot < 64; slot++){
+        if (page->used_mask & ((uint64_t)1 << slot)){
+            if (slot >= page->slot_count){
+                printf("ERROR: Small page at %p marks a slot past its end\n", page->start);
+                return false;
+            }
+            used++;
+        }
+    }
+    if (used != page->used_count){
+        printf("ERROR: Small page at %p counts %u used slots, mask has %u\n",
+                page->start, page->used_count, used);
         return false;
     }
     return true;
@@ -330,7 +1130,7 @@ bool is_valid_header(block_header_t* header) {
     return true;
 }
 
-void* my_realloc_general(void* ptr, size_t new_size, bool is_best_fit){
+static void* realloc_general_unlocked(void* ptr, size_t new_size, bool is_best_fit){
     if (new_size <= 0){
         my_free(ptr);    
         return NULL;
@@ -347,7 +1147,18 @@ void* my_realloc_general(void* ptr, size_t new_size, bool is_best_fit){
     if (new_size > heap_size){
         return NULL;
     }
-    block_header_t* ptr_header = header_from_data_ptr(ptr);
+    small_page_t* page = small_page_from_data_ptr(ptr);
+    if (page){
+        if (new_size <= page->slot_size){
+            return ptr;
+        }
+        void* new_ptr = is_best_fit ? my_alloc_bf(new_size) : my_alloc_ff(new_size);
+        if (!new_ptr) return NULL;
+        memcpy(new_ptr, ptr, page->slot_size);
+        my_free(ptr);
+        return new_ptr;
+    }
+    block_header_t* ptr_header = block_header_at(ptr);
     block_header_t* next_header = next_block_header(ptr_header);
     if (new_size < ptr_header->block_size){
         if (new_size + sizeof(block_header_t) < ptr_header->block_size){
@@ -356,9 +1167,9 @@ void* my_realloc_general(void* ptr, size_t new_size, bool is_best_fit){
             block_header_t* new_free = (block_header_t*)((uint8_t*)(ptr) + new_size);
             new_free->block_size = leftover_space;
             new_free->is_free = true; 
+            new_free->is_zeroed = false;
             return ptr;
         }else{
-            ptr_header->block_size = new_size;
             return ptr;
         }
     }
@@ -370,6 +1181,7 @@ void* my_realloc_general(void* ptr, size_t new_size, bool is_best_fit){
             block_header_t* new_free = (block_header_t*)((uint8_t*)(ptr) + new_size);
             new_free->block_size = available_space - new_required_space - sizeof(block_header_t);
             new_free->is_free = true;
+            new_free->is_zeroed = next_header->is_zeroed;
         }else{
             ptr_header->block_size += available_space;
         }
@@ -393,6 +1205,13 @@ void* my_realloc_general(void* ptr, size_t new_size, bool is_best_fit){
     return NULL;
 }
 
+void* my_realloc_general(void* ptr, size_t new_size, bool is_best_fit){
+    lock_heap();
+    void* p = realloc_general_unlocked(ptr, new_size, is_best_fit);
+    unlock_heap();
+    return p;
+}
+
 void* my_realloc_ff(void* ptr, size_t new_size){
     return my_realloc_general(ptr, new_size, false);
 }
@@ -401,8 +1220,147 @@ void* my_realloc_bf(void* ptr, size_t new_size){
     return my_realloc_general(ptr, new_size, true);
 }
 
+static void coalesce_free_blocks(void){
+    if (!heap){
+        return;
+    }
+    block_header_t* current = (block_header_t*)heap;
+    while (current != NULL){
+        block_header_t* next_block = next_block_header(current);
+        if (current->is_free && next_block && next_block->is_free){
+            bool both_zeroed = current->is_zeroed && next_block->is_zeroed;
+            current->block_size = current->block_size + sizeof(block_header_t) + next_block->block_size;
+            if (both_zeroed){
+                memset(next_block, 0, sizeof(block_header_t));
+            }
+            current->is_zeroed = both_zeroed;
+            continue;
+        }
+        current = next_block;
+    }
+    frees_since_maintenance = 0;
+}
+
+static void scrub_free_blocks(void){
+    block_header_t* current = (block_header_t*)heap;
+    while (current != NULL){
+        if (current->is_free && !current->is_zeroed && current->block_size >= SCRUB_MIN_BLOCK_SIZE){
+            memset((uint8_t*)current + sizeof(block_header_t), 0, current->block_size);
+            current->is_zeroed = true;
+        }
+        current = next_block_header(current);
+    }
+}
+
+static void presplit_small_pages(void){
+    if (!small_block_mode){
+        return;
+    }
+    for (size_t slot_size = ALIGNMENT; slot_size <= SMALL_BLOCK_THRESHOLD; slot_size += ALIGNMENT){
+        bool in_use = false;
+        for (int i = 0; i < MAX_SMALL_PAGES; i++){
+            if (small_pages[i].start != NULL && small_pages[i].slot_size == slot_size){
+                in_use = true;
+            }
+        }
+        if (in_use && !small_page_with_free_slot(slot_size)){
+            add_small_page(slot_size);
+        }
+    }
+}
+
+void run_heap_maintenance(void){
+    lock_heap();
+    if (heap){
+        release_empty_small_pages();
+        coalesce_free_blocks();
+        scrub_free_blocks();
+        presplit_small_pages();
+    }
+    unlock_heap();
+}
 
+static void *maintenance_main(void *arg){
+    unsigned long generation = (unsigned long)(uintptr_t)arg;
+    pthread_mutex_lock(&maintenance_lock);
+    while (generation == maintenance_generation){
+        if (!maintenance_requested){
+            if (maintenance_interval_ms != 0){
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += maintenance_interval_ms / 1000;
+                deadline.tv_nsec += (long)(maintenance_interval_ms % 1000) * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L){
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&maintenance_cond, &maintenance_lock, &deadline);
+            }else{
+                pthread_cond_wait(&maintenance_cond, &maintenance_lock);
+            }
+        }
+        if (generation != maintenance_generation){
+            break;
+        }
+        maintenance_requested = false;
+        // Never hold maintenance_lock while taking the heap lock; my_free
+        // takes them in the opposite order when it triggers a pass.
+        pthread_mutex_unlock(&maintenance_lock);
+        run_heap_maintenance();
+        pthread_mutex_lock(&maintenance_lock);
+    }
+    pthread_mutex_unlock(&maintenance_lock);
+    return NULL;
+}
 
+int start_heap_maintenance(unsigned int interval_ms, size_t free_threshold){
+    lock_heap();
+    if (maintenance_running){
+        unlock_heap();
+        return MY_API_ERROR_INVALID_ARGUMENT;
+    }
+    maintenance_interval_ms = interval_ms;
+    maintenance_free_threshold = free_threshold;
+    frees_since_maintenance = 0;
+    pthread_mutex_lock(&maintenance_lock);
+    unsigned long generation = ++maintenance_generation;
+    maintenance_requested = false;
+    pthread_mutex_unlock(&maintenance_lock);
+    if (pthread_create(&maintenance_thread, NULL, maintenance_main, (void*)(uintptr_t)generation) != 0){
+        unlock_heap();
+        return MALLOC_FAIL;
+    }
+    maintenance_running = true;
+    unlock_heap();
+    return MY_API_SUCCESS;
+}
 
+void stop_heap_maintenance(void){
+    lock_heap();
+    if (!maintenance_running){
+        unlock_heap();
+        return;
+    }
+    // The caller that clears maintenance_running owns the thread handle, so
+    // only one stop joins it and a start can create a new thread right away.
+    pthread_t thread = maintenance_thread;
+    maintenance_running = false;
+    pthread_mutex_lock(&maintenance_lock);
+    maintenance_generation++;
+    pthread_cond_broadcast(&maintenance_cond);
+    pthread_mutex_unlock(&maintenance_lock);
 
+    // my_free coalesces inline again from here on, which relies on no two
+    // free blocks being left next to each other.
+    release_empty_small_pages();
+    coalesce_free_blocks();
+    unlock_heap();
+    pthread_join(thread, NULL);
+}
 
+void trigger_heap_maintenance(void){
+    pthread_mutex_lock(&maintenance_lock);
+    maintenance_requested = true;
+    pthread_cond_signal(&maintenance_cond);
+    pthread_mutex_unlock(&maintenance_lock);
+}
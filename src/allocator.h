@@ -1,9 +1,17 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define ALIGNMENT 16
+#define CACHE_LINE_SIZE 64
 
 extern uint8_t *heap;
 extern size_t heap_size;
@@ -11,10 +19,40 @@ extern size_t heap_size;
 typedef struct BlockHeader{
     size_t block_size;
     bool is_free;
+    bool is_zeroed;
 } block_header_t;
 
+#ifdef __cplusplus
+static_assert(sizeof(block_header_t) % ALIGNMENT == 0,
+                "block_header_t must be a multiple of 16");
+#else
 _Static_assert(sizeof(block_header_t) % ALIGNMENT == 0,
                 "block_header_t must be a multiple of 16");
+#endif
+
+#define SMALL_BLOCK_THRESHOLD 64
+#define SMALL_PAGE_SIZE 512
+#define MAX_SMALL_PAGES 8
+
+// Metadata for a page of header-less small blocks. It lives in its own array,
+// not in the heap, and a bit in used_mask is set for every slot handed out.
+typedef struct SmallPage{
+    uint8_t *start;
+    uint16_t slot_size;
+    uint16_t slot_count;
+    uint16_t used_count;
+    uint64_t used_mask;
+} small_page_t;
+
+#ifdef __cplusplus
+static_assert(SMALL_PAGE_SIZE / ALIGNMENT <= 64,
+                "used_mask must have a bit for every slot of a page");
+#else
+_Static_assert(SMALL_PAGE_SIZE / ALIGNMENT <= 64,
+                "used_mask must have a bit for every slot of a page");
+#endif
+
+extern small_page_t small_pages[MAX_SMALL_PAGES];
 
 int init_heap(size_t size);
 
@@ -26,12 +64,72 @@ bool is_block_free(block_header_t* current_block);
 
 block_header_t* header_from_data_ptr(void *data);
 
+void set_small_block_mode(bool enabled);
+
+small_page_t* small_page_from_data_ptr(void *data);
+
 void* my_alloc_ff(size_t requested_bytes);
 
+// Payload starts on a cache line and is padded to a whole number of lines,
+// so no other allocation shares a line with it. Realloc does not keep this.
+void* my_alloc_exclusive(size_t requested_bytes);
+
 void my_free(void* p);
 
+// size is what was asked for at allocation time. It is only checked
+// against the block in builds without NDEBUG.
+void my_free_sized(void* p, size_t size);
+
+size_t my_usable_size(void* p);
+
+void* my_calloc(size_t count, size_t size);
+
+#define HEAP_WALK_USED 0x1
+#define HEAP_WALK_FREE 0x2
+#define HEAP_WALK_ALL (HEAP_WALK_USED | HEAP_WALK_FREE)
+#define HEAP_WALK_SIZE_RANGE 0x4
+
+// What heap_walk hands to its callback. Points straight into the heap,
+// nothing is copied.
+typedef struct HeapBlockInfo{
+    block_header_t *header;
+    void *payload;
+    size_t offset;
+    size_t size;
+    bool is_free;
+} heap_block_info_t;
+
+// Return false to stop the walk. Runs with the heap locked, so it must not
+// allocate or free.
+typedef bool (*heap_walk_callback_t)(const heap_block_info_t *block, void *ctx);
+
+size_t heap_walk(heap_walk_callback_t callback, void *ctx, unsigned int flags, size_t min_size, size_t max_size);
+
+bool collect_heap_diagnostics(const char *snapshot_filename);
+
 void export_heap_snapshot(const char *filename);
 
+#define MAX_RENDER_BUCKETS 256
+
+// Summary of one fixed-width slice of the heap. Headers count as used.
+typedef struct BucketStats{
+    size_t bucket_bytes;
+    size_t used_bytes;
+    size_t largest_free_run;
+} bucket_stats_t;
+
+size_t heap_bucket_stats(bucket_stats_t *stats, int bucket_count);
+
+void visualize_heap_buckets(int bucket_count);
+
+void visualize_heap_buckets_to_fd(int fd, int bucket_count);
+
+// Redraws only the buckets that changed since the last refresh. That state
+// is shared by all callers, so use one refresh target at a time.
+void refresh_heap_buckets(int bucket_count);
+
+void refresh_heap_buckets_to_fd(int fd, int bucket_count);
+
 void visualize_heap();
 
 void print_heap_overview();
@@ -48,6 +146,24 @@ void* my_realloc_ff(void* ptr, size_t new_size);
 
 void* my_realloc_bf(void* ptr, size_t new_size);
 
+// Opt-in background maintenance. While it runs, my_free skips the backward
+// merge and the thread coalesces free blocks, zeroes large free blocks so
+// my_calloc can skip them, and gives back empty small pages while adding
+// pages for full small size classes.
+// A pass runs every interval_ms and after every free_threshold frees;
+// 0 disables either trigger. The free count stands in for a fragmentation
+// measure: each free made while the thread runs may leave a free block
+// before it unmerged, and checking would need the walk being deferred.
+int start_heap_maintenance(unsigned int interval_ms, size_t free_threshold);
+
+void stop_heap_maintenance(void);
+
+void trigger_heap_maintenance(void);
 
+void run_heap_maintenance(void);
 
+#ifdef __cplusplus
+}
+#endif
 
+#endif
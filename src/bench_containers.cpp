@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "pocket_allocator.hpp"
+
+#define ROUNDS 20000
+#define VECTOR_ELEMENTS 400
+#define MAP_KEYS 64
+#define MAP_OPERATIONS 200
+
+/* ============================================================
+   Container workloads sized to fit the 8KB pocket heap, run once
+   with std::allocator and once with pocket::allocator.
+   ============================================================ */
+
+template <typename Allocator>
+static long push_back_growth() {
+    long sum = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        std::vector<int, Allocator> numbers;
+        for (int i = 0; i < VECTOR_ELEMENTS; i++) {
+            numbers.push_back(i);
+        }
+        sum += numbers.back();
+    }
+    return sum;
+}
+
+template <typename Allocator>
+static long map_churn() {
+    long sum = 0;
+    for (int round = 0; round < ROUNDS / 10; round++) {
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Allocator> table;
+        for (int i = 0; i < MAP_OPERATIONS; i++) {
+            int key = (i * 7) % MAP_KEYS;
+            if (i % 3 == 2) {
+                table.erase(key);
+            } else {
+                table[key] = i;
+            }
+        }
+        sum += (long)table.size();
+    }
+    return sum;
+}
+
+template <typename Workload>
+static double time_ms(Workload workload) {
+    auto start = std::chrono::steady_clock::now();
+    volatile long result = workload();
+    (void)result;
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void report(const char *label, double standard, double pocket_ff, double pocket_bf) {
+    printf("%-18s std::allocator %8.1f ms   pocket ff %8.1f ms   pocket bf %8.1f ms\n",
+           label, standard, pocket_ff, pocket_bf);
+}
+
+int main() {
+    init_heap(8000);
+    using pair_type = std::pair<const int, int>;
+
+    report("push_back growth",
+           time_ms(push_back_growth<std::allocator<int>>),
+           time_ms(push_back_growth<pocket::allocator<int>>),
+           time_ms(push_back_growth<pocket::allocator<int, pocket::strategy::best_fit>>));
+
+    report("map insert/erase",
+           time_ms(map_churn<std::allocator<pair_type>>),
+           time_ms(map_churn<pocket::allocator<pair_type>>),
+           time_ms(map_churn<pocket::allocator<pair_type, pocket::strategy::best_fit>>));
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include "allocator.h"
+
+#define NUM_THREADS 4
+#define INCREMENTS 50000000UL
+
+/* ============================================================
+   Each thread hammers its own counter. The counters are only
+   allocated differently: packed with my_alloc_ff, or one per
+   cache line with my_alloc_exclusive.
+   ============================================================ */
+
+static void *worker(void *arg) {
+    volatile uint64_t *counter = (volatile uint64_t*)arg;
+    for (unsigned long i = 0; i < INCREMENTS; i++) {
+        (*counter)++;
+    }
+    return NULL;
+}
+
+static double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+static double run(void *(*alloc)(size_t), const char *label) {
+    init_heap(4096);
+    void *counters[NUM_THREADS];
+    pthread_t threads[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        counters[i] = alloc(sizeof(uint64_t));
+        *(uint64_t*)counters[i] = 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, worker, counters[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ms = elapsed_ms(start, end);
+    printf("%-20s counters %zu bytes apart: %8.1f ms\n", label,
+           (size_t)((uint8_t*)counters[1] - (uint8_t*)counters[0]), ms);
+    return ms;
+}
+
+int main(void) {
+    printf("%d threads, %lu increments each\n", NUM_THREADS, INCREMENTS);
+    double packed = run(my_alloc_ff, "my_alloc_ff");
+    double exclusive = run(my_alloc_exclusive, "my_alloc_exclusive");
+    printf("speedup: %.2fx\n", packed / exclusive);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#ifndef POCKET_ALLOCATOR_HPP
+#define POCKET_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include "allocator.h"
+
+namespace pocket {
+
+enum class strategy { first_fit, best_fit };
+
+// Allocates from the pocket heap, so init_heap() has to be called first.
+// Alignments up to 16 come from my_alloc_ff/my_alloc_bf, up to a cache line
+// from my_alloc_exclusive. Anything stricter, or a full heap, throws
+// std::bad_alloc.
+inline void* allocate_bytes(std::size_t bytes, std::size_t alignment, strategy how) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    void* p = nullptr;
+    if (alignment <= ALIGNMENT) {
+        p = how == strategy::best_fit ? my_alloc_bf(bytes) : my_alloc_ff(bytes);
+    } else if (alignment <= CACHE_LINE_SIZE) {
+        p = my_alloc_exclusive(bytes);
+    }
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+inline void deallocate_bytes(void* p, std::size_t bytes) {
+    my_free_sized(p, bytes == 0 ? 1 : bytes);
+}
+
+// There is only one pocket heap, so two resources are interchangeable as
+// long as they use the same strategy.
+class memory_resource : public std::pmr::memory_resource {
+public:
+    explicit memory_resource(strategy how = strategy::first_fit) noexcept : how_(how) {}
+
+    strategy how() const noexcept { return how_; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        return allocate_bytes(bytes, alignment, how_);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t) override {
+        deallocate_bytes(p, bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        const memory_resource* pocket = dynamic_cast<const memory_resource*>(&other);
+        return pocket && pocket->how_ == how_;
+    }
+
+    strategy how_;
+};
+
+template <typename T, strategy How = strategy::first_fit>
+class allocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = allocator<U, How>;
+    };
+
+    allocator() noexcept = default;
+
+    template <typename U>
+    allocator(const allocator<U, How>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(allocate_bytes(n * sizeof(T), alignof(T), How));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {
+        deallocate_bytes(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U, strategy How>
+bool operator==(const allocator<T, How>&, const allocator<U, How>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U, strategy How>
+bool operator!=(const allocator<T, How>&, const allocator<U, How>&) noexcept {
+    return false;
+}
+
+}
+
+#endif
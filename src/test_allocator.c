@@ -1,5 +1,10 @@
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "allocator.h"
 #define MY_API_SUCCESS 0
 #define MY_API_ERROR_INVALID_ARGUMENT 1
@@ -20,6 +25,18 @@ static void reset_heap(size_t size) {
     assert(ok == 0);
 }
 
+// Set while the suite runs with the maintenance thread started. my_free
+// leaves the backward merge to the thread then, so tests that check the
+// merged layout run a pass first. With the thread off they check what
+// my_free does on its own.
+static bool maintenance_on = false;
+
+static void settle_deferred_merges(void) {
+    if (maintenance_on) {
+        run_heap_maintenance();
+    }
+}
+
 /* ============================================================
    TESTS FOR init_heap
    ============================================================ */
@@ -165,6 +182,22 @@ void test_my_alloc_ff_uninitialized_heap() {
     assert(my_alloc_ff(50) == NULL);
 }
 
+void test_my_alloc_ff_leftover_too_small_to_split() {
+    reset_heap(128);
+    void *p = my_alloc_ff(96);
+
+    assert(header_from_data_ptr(p)->block_size == 112);
+    assert(check_heap_integrity() == true);
+}
+
+void test_my_alloc_bf_leftover_too_small_to_split() {
+    reset_heap(128);
+    void *p = my_alloc_bf(96);
+
+    assert(header_from_data_ptr(p)->block_size == 112);
+    assert(check_heap_integrity() == true);
+}
+
 /* ============================================================
    TESTS FOR my_free
    ============================================================ */
@@ -177,6 +210,7 @@ void test_my_free_three_way_coalescing() {
     my_free(p1);
     my_free(p3);
     my_free(p2);
+    settle_deferred_merges();
     
     block_header_t* header = header_from_data_ptr(p1); 
     size_t size_of_header = header->block_size;
@@ -274,6 +308,16 @@ void test_realloc_shrink() {
     assert(p == p2);  
 }
 
+void test_realloc_shrink_leftover_too_small_to_split() {
+    reset_heap(1000);
+    void *p = my_alloc_ff(48);
+    my_alloc_ff(16);
+
+    assert(my_realloc_ff(p, 32) == p);
+    assert(header_from_data_ptr(p)->block_size == 48);
+    assert(check_heap_integrity() == true);
+}
+
 void test_realloc_grow_in_place() {
     reset_heap(1000);
     void *p = my_alloc_ff(50);
@@ -308,12 +352,719 @@ void test_realloc_preserves_data() {
 }
 
 /* ============================================================
-   MAIN: run all tests
+   Calloc Check
    ============================================================ */
 
-int main() {
-    printf("Running allocator tests...\n");
+void test_calloc_fresh_heap_is_zero() {
+    reset_heap(1000);
+    block_header_t *first = (block_header_t*)heap;
+    assert(first->is_zeroed == true);
+
+    uint8_t *p = (uint8_t*)my_calloc(10, 8);
+    assert(p != NULL);
+    for (int i = 0; i < 80; i++) {
+        assert(p[i] == 0);
+    }
+    block_header_t *rest = next_block_header(header_from_data_ptr(p));
+    assert(rest->is_free == true);
+    assert(rest->is_zeroed == true);
+}
+
+void test_calloc_zeroes_reused_block() {
+    reset_heap(1000);
+    uint8_t *p1 = (uint8_t*)my_alloc_ff(64);
+    my_alloc_ff(16);
+    for (int i = 0; i < 64; i++) {
+        p1[i] = 0xAB;
+    }
+    my_free(p1);
+    assert(header_from_data_ptr(p1)->is_zeroed == false);
+
+    uint8_t *p2 = (uint8_t*)my_calloc(4, 16);
+    assert(p2 == p1);
+    for (int i = 0; i < 64; i++) {
+        assert(p2[i] == 0);
+    }
+    assert(check_heap_integrity() == true);
+}
+
+void test_calloc_coalesce_clears_zero_flag() {
+    reset_heap(1000);
+    void *p1 = my_alloc_ff(32);
+    my_free(p1);
+
+    block_header_t *first = (block_header_t*)heap;
+    assert(first->is_free == true);
+    assert(first->is_zeroed == false);
+}
+
+void test_calloc_overflow() {
+    reset_heap(1000);
+    assert(my_calloc(SIZE_MAX / 2, 4) == NULL);
+    assert(my_calloc(0, 16) == NULL);
+    assert(my_calloc(16, 0) == NULL);
+}
+
+/* ============================================================
+   Exclusive (cache line) allocation Check
+   ============================================================ */
+
+void test_alloc_exclusive_alignment() {
+    reset_heap(2000);
+    my_alloc_ff(8);
+    void *p1 = my_alloc_exclusive(8);
+    void *p2 = my_alloc_exclusive(8);
+
+    assert(p1 != NULL);
+    assert(p2 != NULL);
+    assert(((uintptr_t)p1 % CACHE_LINE_SIZE) == 0);
+    assert(((uintptr_t)p2 % CACHE_LINE_SIZE) == 0);
+    assert((uint8_t*)p2 - (uint8_t*)p1 >= CACHE_LINE_SIZE + (long)sizeof(block_header_t));
+    assert(header_from_data_ptr(p1)->block_size % CACHE_LINE_SIZE == 0);
+    assert(check_heap_integrity() == true);
+}
+
+void test_alloc_exclusive_line_not_shared() {
+    reset_heap(2000);
+    uint8_t *p = (uint8_t*)my_alloc_exclusive(40);
+    void *after = my_alloc_ff(8);
+
+    uintptr_t line_start = (uintptr_t)p;
+    uintptr_t line_end = line_start + CACHE_LINE_SIZE;
+    assert((uintptr_t)after + 8 <= line_start || (uintptr_t)after >= line_end);
+}
+
+void test_alloc_exclusive_padding_becomes_free_block() {
+    reset_heap(2000);
+    // Size the first block so the free payload after it starts 16 bytes
+    // into a cache line, leaving a 48-byte gap before the next line.
+    uintptr_t free_payload = (uintptr_t)heap + 2 * sizeof(block_header_t);
+    size_t before_size = (CACHE_LINE_SIZE + 16 - free_payload % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+    if (before_size == 0) before_size = CACHE_LINE_SIZE;
+    void *before = my_alloc_ff(before_size);
+    void *p = my_alloc_exclusive(64);
+    block_header_t *h = header_from_data_ptr(p);
+
+    block_header_t *front = next_block_header(header_from_data_ptr(before));
+    assert(front != h);
+    assert(front->is_free == true);
+    assert(front->block_size == 32);
+    assert(next_block_header(front) == h);
+
+    my_free(before);
+    my_free(p);
+    settle_deferred_merges();
+    block_header_t *first = (block_header_t*)heap;
+    assert(first->is_free == true);
+    assert(first->block_size == heap_size - sizeof(block_header_t));
+}
+
+/* ============================================================
+   Header-less small block Check
+   ============================================================ */
+
+void test_small_blocks_have_no_headers() {
+    reset_heap(2000);
+    set_small_block_mode(true);
+    uint8_t *p1 = (uint8_t*)my_alloc_ff(16);
+    uint8_t *p2 = (uint8_t*)my_alloc_ff(10);
+    uint8_t *p3 = (uint8_t*)my_alloc_bf(16);
+
+    assert(p2 - p1 == 16);
+    assert(p3 - p2 == 16);
+    small_page_t *page = small_page_from_data_ptr(p1);
+    assert(page != NULL);
+    assert(page == small_page_from_data_ptr(p3));
+    assert(page->slot_size == 16);
+    assert(page->used_count == 3);
+    assert(check_heap_integrity() == true);
+    set_small_block_mode(false);
+}
+
+void test_header_from_data_ptr_small_block() {
+    reset_heap(2000);
+    set_small_block_mode(true);
+    void *p1 = my_alloc_ff(16);
+    void *p2 = my_alloc_ff(16);
+    void *big = my_alloc_ff(200);
+
+    assert(small_page_from_data_ptr(p1) != NULL);
+    assert(header_from_data_ptr(p1) == NULL);
+    assert(header_from_data_ptr(p2) == NULL);
+    assert(header_from_data_ptr(big) != NULL);
+    set_small_block_mode(false);
+}
 
+void test_small_blocks_separate_size_classes() {
+    reset_heap(2000);
+    set_small_block_mode(true);
+    void *p1 = my_alloc_ff(16);
+    void *p2 = my_alloc_ff(48);
+    void *big = my_alloc_ff(200);
+
+    assert(small_page_from_data_ptr(p1) != small_page_from_data_ptr(p2));
+    assert(small_page_from_data_ptr(p2)->slot_size == 48);
+    assert(small_page_from_data_ptr(big) == NULL);
+    assert(header_from_data_ptr(big)->block_size == 208);
+    set_small_block_mode(false);
+}
+
+void test_small_blocks_free_releases_page() {
+    reset_heap(2000);
+    set_small_block_mode(true);
+    void *p1 = my_alloc_ff(32);
+    void *p2 = my_alloc_ff(32);
+
+    my_free(p1);
+    assert(small_page_from_data_ptr(p2)->used_count == 1);
+    void *p3 = my_alloc_ff(32);
+    assert(p3 == p1);
+
+    my_free(p2);
+    my_free(p3);
+    assert(small_page_from_data_ptr(p1) == NULL);
+    block_header_t *first = (block_header_t*)heap;
+    assert(first->is_free == true);
+    assert(first->block_size == heap_size - sizeof(block_header_t));
+    set_small_block_mode(false);
+}
+
+void test_small_blocks_realloc_leaves_page() {
+    reset_heap(2000);
+    set_small_block_mode(true);
+    int *arr = (int*)my_alloc_ff(4 * sizeof(int));
+    for (int i = 0; i < 4; i++) {
+        arr[i] = i + 1;
+    }
+    assert(my_realloc_ff(arr, 12) == arr);
+
+    int *grown = (int*)my_realloc_ff(arr, 100 * sizeof(int));
+    assert(small_page_from_data_ptr(grown) == NULL);
+    for (int i = 0; i < 4; i++) {
+        assert(grown[i] == i + 1);
+    }
+    assert(check_heap_integrity() == true);
+    set_small_block_mode(false);
+}
+
+void test_small_blocks_fall_back_when_page_does_not_fit() {
+    reset_heap(400);
+    set_small_block_mode(true);
+    void *p1 = my_alloc_ff(16);
+    void *p2 = my_alloc_bf(16);
+
+    assert(p1 != NULL);
+    assert(p2 != NULL);
+    assert(small_page_from_data_ptr(p1) == NULL);
+    assert(header_from_data_ptr(p1)->block_size == 16);
+    my_free(p1);
+    my_free(p2);
+    assert(check_heap_integrity() == true);
+    set_small_block_mode(false);
+}
+
+void test_small_blocks_fall_back_when_pages_run_out() {
+    reset_heap(MAX_HEAP_SIZE);
+    set_small_block_mode(true);
+    int slots_per_page = SMALL_PAGE_SIZE / 64;
+    for (int i = 0; i < MAX_SMALL_PAGES * slots_per_page; i++) {
+        assert(small_page_from_data_ptr(my_alloc_ff(64)) != NULL);
+    }
+    void *p = my_alloc_ff(64);
+
+    assert(p != NULL);
+    assert(small_page_from_data_ptr(p) == NULL);
+    assert(header_from_data_ptr(p)->block_size == 64);
+    assert(check_heap_integrity() == true);
+    set_small_block_mode(false);
+}
+
+void test_small_blocks_integrity_detects_bad_mask() {
+    reset_heap(2000);
+    set_small_block_mode(true);
+    void *p = my_alloc_ff(16);
+
+    small_page_t *page = small_page_from_data_ptr(p);
+    page->used_mask |= 0x6;
+    assert(check_heap_integrity() == false);
+    set_small_block_mode(false);
+}
+
+/* ============================================================
+   Background maintenance Check
+   ============================================================ */
+
+typedef struct {
+    void *payload;
+    size_t size;
+} block_query_t;
+
+static bool find_block(const heap_block_info_t *block, void *ctx) {
+    block_query_t *query = (block_query_t*)ctx;
+    if (block->payload == query->payload) {
+        query->size = block->size;
+        return false;
+    }
+    return true;
+}
+
+// Reads the block size through heap_walk, which holds the heap lock, so it
+// is safe while the maintenance thread is running.
+static void wait_for_block_size(void *payload, size_t size) {
+    block_query_t query = {payload, 0};
+    for (int i = 0; i < 1000; i++) {
+        heap_walk(find_block, &query, HEAP_WALK_ALL, 0, 0);
+        if (query.size == size) {
+            return;
+        }
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
+    assert(query.size == size);
+}
+
+void test_maintenance_defers_backward_merge() {
+    reset_heap(1000);
+    assert(start_heap_maintenance(0, 0) == 0);
+    void *p1 = my_alloc_ff(16);
+    void *p2 = my_alloc_ff(16);
+    my_alloc_ff(16);
+
+    my_free(p1);
+    my_free(p2);
+    assert(header_from_data_ptr(p1)->block_size == 16);
+
+    trigger_heap_maintenance();
+    wait_for_block_size(p1, 48);
+    assert(check_heap_integrity() == true);
+    stop_heap_maintenance();
+}
+
+void test_maintenance_free_threshold_triggers_pass() {
+    reset_heap(1000);
+    assert(start_heap_maintenance(0, 2) == 0);
+    void *p1 = my_alloc_ff(16);
+    void *p2 = my_alloc_ff(16);
+    void *p3 = my_alloc_ff(16);
+    my_alloc_ff(16);
+
+    my_free(p1);
+    my_free(p2);
+    wait_for_block_size(p1, 48);
+    my_free(p3);
+    stop_heap_maintenance();
+
+    assert(header_from_data_ptr(p1)->block_size == 80);
+    assert(check_heap_integrity() == true);
+}
+
+void test_maintenance_interval_runs_passes() {
+    reset_heap(1000);
+    assert(start_heap_maintenance(1, 0) == 0);
+    assert(start_heap_maintenance(1, 0) != 0);
+    void *p1 = my_alloc_ff(16);
+    void *p2 = my_alloc_ff(16);
+    my_alloc_ff(16);
+
+    my_free(p1);
+    my_free(p2);
+    wait_for_block_size(p1, 48);
+    stop_heap_maintenance();
+}
+
+static void *stop_maintenance(void *arg) {
+    (void)arg;
+    stop_heap_maintenance();
+    return NULL;
+}
+
+void test_maintenance_concurrent_stop() {
+    reset_heap(1000);
+    for (int round = 0; round < 100; round++) {
+        assert(start_heap_maintenance(1, 0) == 0);
+        pthread_t threads[2];
+        for (int i = 0; i < 2; i++) {
+            pthread_create(&threads[i], NULL, stop_maintenance, NULL);
+        }
+        for (int i = 0; i < 2; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    assert(start_heap_maintenance(0, 0) == 0);
+    stop_heap_maintenance();
+    assert(check_heap_integrity() == true);
+}
+
+static void *churn_heap(void *arg) {
+    unsigned int seed = *(unsigned int*)arg;
+    void *live[16] = {NULL};
+    for (int i = 0; i < 20000; i++) {
+        int slot = rand_r(&seed) % 16;
+        if (live[slot]) {
+            my_free(live[slot]);
+            live[slot] = NULL;
+        } else {
+            live[slot] = my_alloc_ff(1 + rand_r(&seed) % 200);
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        if (live[i]) {
+            my_free(live[i]);
+        }
+    }
+    return NULL;
+}
+
+void test_maintenance_passes_during_churn() {
+    reset_heap(MAX_HEAP_SIZE);
+    set_small_block_mode(true);
+    assert(start_heap_maintenance(1, 8) == 0);
+
+    pthread_t threads[2];
+    unsigned int seeds[2] = {1, 2};
+    for (int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], NULL, churn_heap, &seeds[i]);
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    stop_heap_maintenance();
+    set_small_block_mode(false);
+
+    assert(check_heap_integrity() == true);
+    block_header_t *first = (block_header_t*)heap;
+    assert(first->is_free == true);
+    assert(first->block_size == heap_size - sizeof(block_header_t));
+}
+
+void test_maintenance_alloc_falls_back_to_coalescing() {
+    reset_heap(128);
+    assert(start_heap_maintenance(0, 0) == 0);
+    void *p1 = my_alloc_ff(32);
+    void *p2 = my_alloc_ff(32);
+
+    my_free(p1);
+    my_free(p2);
+    void *big = my_alloc_ff(96);
+    assert(big == p1);
+    stop_heap_maintenance();
+}
+
+void test_maintenance_scrubs_free_blocks() {
+    reset_heap(2000);
+    uint8_t *p = (uint8_t*)my_alloc_ff(512);
+    my_alloc_ff(16);
+    memset(p, 0xAB, 512);
+    my_free(p);
+    assert(header_from_data_ptr(p)->is_zeroed == false);
+
+    run_heap_maintenance();
+    assert(header_from_data_ptr(p)->is_zeroed == true);
+    for (int i = 0; i < 512; i++) {
+        assert(p[i] == 0);
+    }
+}
+
+void test_maintenance_presplits_full_size_class() {
+    reset_heap(4000);
+    set_small_block_mode(true);
+    void *slots[SMALL_PAGE_SIZE / 64];
+    slots[0] = my_alloc_ff(64);
+    small_page_t *page = small_page_from_data_ptr(slots[0]);
+    int slot_count = page->slot_count;
+    for (int i = 1; i < slot_count; i++) {
+        slots[i] = my_alloc_ff(64);
+    }
+    run_heap_maintenance();
+
+    int pages_of_class = 0;
+    for (int i = 0; i < MAX_SMALL_PAGES; i++) {
+        if (small_pages[i].start != NULL && small_pages[i].slot_size == 64) {
+            pages_of_class++;
+        }
+    }
+    assert(pages_of_class == 2);
+    assert(check_heap_integrity() == true);
+
+    // The pre-split page is never used, so it has to be given back too.
+    for (int i = 0; i < slot_count; i++) {
+        my_free(slots[i]);
+    }
+    set_small_block_mode(false);
+    run_heap_maintenance();
+    block_header_t *first = (block_header_t*)heap;
+    assert(first->is_free == true);
+    assert(first->block_size == heap_size - sizeof(block_header_t));
+    assert(check_heap_integrity() == true);
+}
+
+/* ============================================================
+   Heap walk Check
+   ============================================================ */
+
+typedef struct {
+    int count;
+    size_t total_size;
+    void *last_payload;
+} walk_tally_t;
+
+static bool tally_block(const heap_block_info_t *block, void *ctx) {
+    walk_tally_t *tally = (walk_tally_t*)ctx;
+    tally->count++;
+    tally->total_size += block->size;
+    tally->last_payload = block->payload;
+    return true;
+}
+
+static bool stop_after_first(const heap_block_info_t *block, void *ctx) {
+    (void)block;
+    (*(int*)ctx)++;
+    return false;
+}
+
+void test_heap_walk_filters() {
+    reset_heap(1000);
+    void *p1 = my_alloc_ff(32);
+    void *p2 = my_alloc_ff(100);
+    my_alloc_ff(16);
+    my_free(p1);
+
+    walk_tally_t all = {0, 0, NULL};
+    assert(heap_walk(tally_block, &all, HEAP_WALK_ALL, 0, 0) == 4);
+    assert(all.count == 4);
+    assert(all.total_size + 4 * sizeof(block_header_t) == heap_size);
+
+    walk_tally_t used = {0, 0, NULL};
+    heap_walk(tally_block, &used, HEAP_WALK_USED, 0, 0);
+    assert(used.count == 2);
+
+    walk_tally_t free_blocks = {0, 0, NULL};
+    heap_walk(tally_block, &free_blocks, HEAP_WALK_FREE, 0, 0);
+    assert(free_blocks.count == 2);
+
+    walk_tally_t ranged = {0, 0, NULL};
+    heap_walk(tally_block, &ranged, HEAP_WALK_USED | HEAP_WALK_SIZE_RANGE, 64, 128);
+    assert(ranged.count == 1);
+    assert(ranged.last_payload == p2);
+}
+
+void test_heap_walk_stops_early() {
+    reset_heap(1000);
+    my_alloc_ff(32);
+    my_alloc_ff(32);
+
+    int calls = 0;
+    heap_walk(stop_after_first, &calls, HEAP_WALK_ALL, 0, 0);
+    assert(calls == 1);
+}
+
+void test_collect_heap_diagnostics() {
+    reset_heap(1000);
+    my_alloc_ff(50);
+    my_alloc_ff(100);
+    assert(collect_heap_diagnostics("test_diagnostics.json") == true);
+
+    FILE *f = fopen("test_diagnostics.json", "r");
+    assert(f != NULL);
+    char text[1024];
+    size_t length = fread(text, 1, sizeof(text) - 1, f);
+    text[length] = '\0';
+    fclose(f);
+    remove("test_diagnostics.json");
+    assert(strstr(text, "\"offset\": 0, \"size\": 64, \"is_free\": false") != NULL);
+
+    header_from_data_ptr(heap + sizeof(block_header_t))->block_size = 9999999;
+    assert(collect_heap_diagnostics(NULL) == false);
+}
+
+/* ============================================================
+   Bucket renderer Check
+   ============================================================ */
+
+void test_heap_bucket_stats() {
+    reset_heap(1024);
+    void *p1 = my_alloc_ff(240);
+    my_alloc_ff(240);
+    my_free(p1);
+
+    bucket_stats_t stats[4];
+    assert(heap_bucket_stats(stats, 4) == 256);
+
+    assert(stats[0].bucket_bytes == 256);
+    assert(stats[0].used_bytes == 16);
+    assert(stats[0].largest_free_run == 240);
+    assert(stats[1].used_bytes == 256);
+    assert(stats[1].largest_free_run == 0);
+    assert(stats[2].used_bytes == 16);
+    assert(stats[2].largest_free_run == 240);
+    assert(stats[3].used_bytes == 0);
+    assert(stats[3].largest_free_run == 256);
+}
+
+void test_heap_bucket_stats_bad_count() {
+    reset_heap(1024);
+    bucket_stats_t stats[1];
+    assert(heap_bucket_stats(stats, 0) == 0);
+    assert(heap_bucket_stats(NULL, 4) == 0);
+}
+
+static int render_pipe[2];
+
+static void open_render_pipe(void) {
+    assert(pipe(render_pipe) == 0);
+}
+
+static size_t read_render_pipe(char *text, size_t capacity) {
+    close(render_pipe[1]);
+    size_t length = 0;
+    ssize_t got;
+    while (length < capacity - 1 && (got = read(render_pipe[0], text + length, capacity - 1 - length)) > 0) {
+        length += (size_t)got;
+    }
+    text[length] = '\0';
+    close(render_pipe[0]);
+    return length;
+}
+
+static int count_occurrences(const char *text, const char *needle) {
+    int count = 0;
+    for (const char *at = strstr(text, needle); at != NULL; at = strstr(at + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+void test_visualize_heap_buckets_frame() {
+    reset_heap(1024);
+    void *p1 = my_alloc_ff(240);
+    my_alloc_ff(240);
+    my_free(p1);
+
+    char text[8192];
+    open_render_pipe();
+    visualize_heap_buckets_to_fd(render_pipe[1], 4);
+    read_render_pipe(text, sizeof(text));
+
+    assert(strstr(text, "HEAP BUCKETS: 4 x 256 bytes (heap 1024)") != NULL);
+    assert(count_occurrences(text, "largest free") == 4);
+    assert(strstr(text, "   0      0 [") != NULL);
+    assert(strstr(text, "]   6% used, largest free 240") != NULL);
+    assert(strstr(text, "] 100% used, largest free 0") != NULL);
+    assert(strstr(text, "]   0% used, largest free 256") != NULL);
+}
+
+void test_refresh_heap_buckets_redraws_changes_only() {
+    reset_heap(1024);
+    void *p = my_alloc_ff(32);
+    my_alloc_ff(16);
+    char text[8192];
+
+    // A different bucket count always starts from a cleared screen.
+    open_render_pipe();
+    refresh_heap_buckets_to_fd(render_pipe[1], 3);
+    read_render_pipe(text, sizeof(text));
+    open_render_pipe();
+    refresh_heap_buckets_to_fd(render_pipe[1], 4);
+    read_render_pipe(text, sizeof(text));
+    assert(strstr(text, "\033[2J") != NULL);
+    assert(count_occurrences(text, "largest free") == 4);
+
+    open_render_pipe();
+    refresh_heap_buckets_to_fd(render_pipe[1], 4);
+    read_render_pipe(text, sizeof(text));
+    assert(strstr(text, "\033[2J") == NULL);
+    assert(count_occurrences(text, "largest free") == 0);
+
+    my_free(p);
+    settle_deferred_merges();
+    open_render_pipe();
+    refresh_heap_buckets_to_fd(render_pipe[1], 4);
+    read_render_pipe(text, sizeof(text));
+    assert(count_occurrences(text, "largest free") == 1);
+    assert(strstr(text, "\033[2;1H") != NULL);
+}
+
+/* ============================================================
+   Sized free and usable size Check
+   ============================================================ */
+
+void test_usable_size_includes_rounding() {
+    reset_heap(1000);
+    void *p = my_alloc_ff(50);
+    assert(my_usable_size(p) == 64);
+    assert(my_usable_size(NULL) == 0);
+
+    my_free(p);
+    assert(my_usable_size(p) == 0);
+}
+
+void test_usable_size_small_block() {
+    reset_heap(2000);
+    set_small_block_mode(true);
+    uint8_t *p = (uint8_t*)my_alloc_ff(20);
+    uint8_t *q = (uint8_t*)my_alloc_ff(20);
+    assert(my_usable_size(p) == 32);
+    assert(my_usable_size(p + 3) == 0);
+    my_free(q);
+    assert(my_usable_size(q) == 0);
+    my_free_sized(p, 20);
+    assert(small_page_from_data_ptr(p) == NULL);
+    set_small_block_mode(false);
+}
+
+void test_free_sized_coalesces() {
+    reset_heap(1000);
+    void *p1 = my_alloc_ff(100);
+    void *p2 = my_alloc_ff(100);
+    my_alloc_ff(16);
+
+    my_free_sized(p2, 100);
+    my_free_sized(p1, 100);
+    assert(header_from_data_ptr(p1)->is_free == true);
+    assert(header_from_data_ptr(p1)->block_size == 112 + sizeof(block_header_t) + 112);
+    assert(check_heap_integrity() == true);
+}
+
+void test_free_sized_rejects_wrong_size() {
+    reset_heap(1000);
+    void *p = my_alloc_ff(32);
+    my_alloc_ff(16);
+
+    my_free_sized(p, 200);
+    assert(header_from_data_ptr(p)->is_free == false);
+    my_free_sized(p, 32);
+    assert(header_from_data_ptr(p)->is_free == true);
+}
+
+void test_free_sized_accepts_unsplit_slack() {
+    reset_heap(128);
+    void *p = my_alloc_ff(96);
+    my_free_sized(p, 96);
+    assert(header_from_data_ptr(p)->is_free == true);
+
+    reset_heap(1000);
+    void *line = my_alloc_exclusive(8);
+    my_alloc_ff(16);
+    my_free_sized(line, 8);
+    assert(header_from_data_ptr(line)->is_free == true);
+}
+
+void test_free_sized_rejects_size_far_below_block() {
+    reset_heap(1000);
+    void *p = my_alloc_ff(100);
+    my_alloc_ff(16);
+
+    my_free_sized(p, 16);
+    assert(header_from_data_ptr(p)->is_free == false);
+    my_free_sized(p, 100);
+    assert(header_from_data_ptr(p)->is_free == true);
+}
+
+/* ============================================================
+   MAIN: run all tests
+   ============================================================ */
+
+static void run_all_tests() {
     test_init_heap_basic();
     test_init_heap_zero();
     test_init_heap_too_large();
@@ -335,6 +1086,8 @@ int main() {
     test_my_alloc_ff_allocate_zero();
     test_my_alloc_ff_allocate_more_than_heap_size();
     test_my_alloc_ff_uninitialized_heap();
+    test_my_alloc_ff_leftover_too_small_to_split();
+    test_my_alloc_bf_leftover_too_small_to_split();
 
     test_my_free_three_way_coalescing();
     test_my_free_and_reallocate();
@@ -348,10 +1101,70 @@ int main() {
     test_integrity_checker_passes();
 
     test_realloc_shrink();
+    test_realloc_shrink_leftover_too_small_to_split();
     test_realloc_grow_in_place();
     test_realloc_must_move();
     test_realloc_preserves_data();
 
+    test_calloc_fresh_heap_is_zero();
+    test_calloc_zeroes_reused_block();
+    test_calloc_coalesce_clears_zero_flag();
+    test_calloc_overflow();
+
+    test_alloc_exclusive_alignment();
+    test_alloc_exclusive_line_not_shared();
+    test_alloc_exclusive_padding_becomes_free_block();
+
+    test_small_blocks_have_no_headers();
+    test_header_from_data_ptr_small_block();
+    test_small_blocks_separate_size_classes();
+    test_small_blocks_free_releases_page();
+    test_small_blocks_realloc_leaves_page();
+    test_small_blocks_fall_back_when_page_does_not_fit();
+    test_small_blocks_fall_back_when_pages_run_out();
+    test_small_blocks_integrity_detects_bad_mask();
+
+    test_heap_walk_filters();
+    test_heap_walk_stops_early();
+    test_collect_heap_diagnostics();
+
+    test_heap_bucket_stats();
+    test_heap_bucket_stats_bad_count();
+    test_visualize_heap_buckets_frame();
+    test_refresh_heap_buckets_redraws_changes_only();
+
+    test_usable_size_includes_rounding();
+    test_usable_size_small_block();
+    test_free_sized_coalesces();
+    test_free_sized_rejects_wrong_size();
+    test_free_sized_rejects_size_far_below_block();
+    test_free_sized_accepts_unsplit_slack();
+}
+
+int main() {
+    printf("Running allocator tests...\n");
+
+    run_all_tests();
+
+    // The thread is started without a timer or free threshold, so it only
+    // runs a pass when an allocation falls back to coalescing. This run
+    // checks the deferred-merge path; test_maintenance_passes_during_churn
+    // covers passes running alongside allocations.
+    printf("Running allocator tests with deferred merges...\n");
+    assert(start_heap_maintenance(0, 0) == 0);
+    maintenance_on = true;
+    run_all_tests();
+    maintenance_on = false;
+    stop_heap_maintenance();
+
+    test_maintenance_defers_backward_merge();
+    test_maintenance_free_threshold_triggers_pass();
+    test_maintenance_interval_runs_passes();
+    test_maintenance_concurrent_stop();
+    test_maintenance_alloc_falls_back_to_coalescing();
+    test_maintenance_scrubs_free_blocks();
+    test_maintenance_presplits_full_size_class();
+    test_maintenance_passes_during_churn();
 
     printf("All tests passed successfully.\n");
     return 0;
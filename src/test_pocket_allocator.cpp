@@ -0,0 +1,118 @@
+#include <cassert>
+#include <cstdio>
+#include <memory_resource>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include "pocket_allocator.hpp"
+
+/* ============================================================
+   TESTS FOR the C++ adapters
+   ============================================================ */
+
+static bool in_heap(const void* p) {
+    const uint8_t* byte_ptr = static_cast<const uint8_t*>(p);
+    return byte_ptr >= heap && byte_ptr < heap + heap_size;
+}
+
+void test_stl_allocator_vector() {
+    init_heap(4000);
+    std::vector<int, pocket::allocator<int>> numbers;
+    for (int i = 0; i < 200; i++) {
+        numbers.push_back(i);
+    }
+    assert(in_heap(numbers.data()));
+    for (int i = 0; i < 200; i++) {
+        assert(numbers[i] == i);
+    }
+    numbers.clear();
+    numbers.shrink_to_fit();
+    assert(check_heap_integrity() == true);
+}
+
+void test_stl_allocator_map_rebinds() {
+    init_heap(8000);
+    using map_allocator = pocket::allocator<std::pair<const int, int>, pocket::strategy::best_fit>;
+    {
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, map_allocator> squares;
+        for (int i = 0; i < 50; i++) {
+            squares[i] = i * i;
+        }
+        for (int i = 0; i < 50; i += 2) {
+            squares.erase(i);
+        }
+        assert(squares.size() == 25);
+        assert(squares.at(7) == 49);
+    }
+    block_header_t* first = (block_header_t*)heap;
+    assert(first->is_free == true);
+    assert(first->block_size == heap_size - sizeof(block_header_t));
+}
+
+void test_stl_allocator_throws_when_full() {
+    init_heap(256);
+    pocket::allocator<char> chars;
+    bool threw = false;
+    try {
+        chars.allocate(1000);
+    } catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_memory_resource_pmr_vector() {
+    init_heap(4000);
+    pocket::memory_resource resource(pocket::strategy::best_fit);
+    std::pmr::vector<double> values(&resource);
+    for (int i = 0; i < 100; i++) {
+        values.push_back(i * 0.5);
+    }
+    assert(in_heap(values.data()));
+    assert(values[99] == 49.5);
+}
+
+void test_memory_resource_alignment() {
+    init_heap(4000);
+    pocket::memory_resource resource;
+    void* p = resource.allocate(8, 64);
+    assert(((uintptr_t)p % 64) == 0);
+    resource.deallocate(p, 8, 64);
+
+    bool threw = false;
+    try {
+        (void)resource.allocate(8, 128);
+    } catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(check_heap_integrity() == true);
+}
+
+void test_memory_resource_is_equal() {
+    pocket::memory_resource first_fit;
+    pocket::memory_resource other_first_fit;
+    pocket::memory_resource best_fit(pocket::strategy::best_fit);
+    assert(first_fit == other_first_fit);
+    assert(first_fit != best_fit);
+    assert(first_fit != *std::pmr::new_delete_resource());
+}
+
+/* ============================================================
+   MAIN: run all tests
+   ============================================================ */
+
+int main() {
+    printf("Running C++ adapter tests...\n");
+
+    test_stl_allocator_vector();
+    test_stl_allocator_map_rebinds();
+    test_stl_allocator_throws_when_full();
+
+    test_memory_resource_pmr_vector();
+    test_memory_resource_alignment();
+    test_memory_resource_is_equal();
+
+    printf("All tests passed successfully.\n");
+    return 0;
+}